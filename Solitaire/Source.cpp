@@ -5,8 +5,31 @@
 #include <random>
 #include <map>
 #include <stack>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <numeric>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <future>
 #include "raylib.h"
 
+#if defined(_WIN32)
+// windows.h clashes with raylib, so only the one call that is needed is declared
+extern "C" __declspec(dllimport) int __stdcall SetThreadPriority(void* thread, int priority);
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using namespace std;
 struct insideCard
 {
@@ -20,6 +43,272 @@ struct insideCard
 
     insideCard() = default;
 };
+// Card as a small number: suit * 13 + rank, with rank 0 the Ace and suits
+// in initializeDeck order
+int cardIndex(const insideCard* card)
+{
+    static const map<string, int> suitValues = { {"Hearts", 0}, {"Diamonds", 1}, {"Clubs", 2}, {"Spades", 3} };
+    static const map<string, int> rankValues = {
+        {"A", 0}, {"2", 1}, {"3", 2}, {"4", 3}, {"5", 4}, {"6", 5}, {"7", 6}, {"8", 7}, {"9", 8}, {"10", 9}, {"J", 10}, {"Q", 11}, {"K", 12} };
+    return suitValues.at(card->suit) * 13 + rankValues.at(card->rank);
+}
+
+string cardName(int index)
+{
+    static const char* suits[] = { "Hearts", "Diamonds", "Clubs", "Spades" };
+    static const char* ranks[] = { "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
+    return string(ranks[index % 13]) + " of " + suits[index / 13];
+}
+
+// Set SOLITAIRE_EVENT_LOG to 0 to compile the event log and every LOG_MOVE out
+#ifndef SOLITAIRE_EVENT_LOG
+#define SOLITAIRE_EVENT_LOG 1
+#endif
+
+// raylib already uses LOG_* for its own trace levels
+enum EventLevel
+{
+    EVENT_DEBUG, // rejected move attempts
+    EVENT_INFO,  // moves that were made
+    EVENT_OFF
+};
+
+enum MoveType
+{
+    MOVE_TABLEAU_TO_TABLEAU,
+    MOVE_TABLEAU_TO_FOUNDATION,
+    MOVE_WASTE_TO_TABLEAU,
+    MOVE_WASTE_TO_FOUNDATION,
+    MOVE_FOUNDATION_TO_TABLEAU
+};
+
+enum MoveResult
+{
+    MOVE_OK,
+    MOVE_BAD_INDEX,
+    MOVE_EMPTY_SOURCE,
+    MOVE_BAD_COUNT,
+    MOVE_FACE_DOWN,
+    MOVE_BAD_SEQUENCE,
+    MOVE_KING_ONLY,
+    MOVE_NOT_ALLOWED,
+    MOVE_EVENTS_DROPPED // marker written by the log itself, count holds how many events were lost
+};
+
+// One log record, fixed size so it can be copied through the ring buffer and
+// written to a binary sink as is. A --log-binary file is nothing but these
+// 16-byte records back to back, in host byte order and with no header; lost
+// events show up as MOVE_EVENTS_DROPPED records with type -1.
+struct MoveEvent
+{
+    int64_t timestamp;  // steady_clock nanoseconds
+    signed char level;
+    signed char type;
+    signed char result;
+    signed char from;   // pile indices, -1 when there is none
+    signed char to;
+    signed char card;   // cardIndex of the first card moved, -1 if unknown
+    int16_t count;      // cards moved, or events lost for MOVE_EVENTS_DROPPED
+};
+static_assert(sizeof(MoveEvent) == 16, "MoveEvent is written to disk as is");
+
+#if SOLITAIRE_EVENT_LOG
+
+// Lock-free queue for exactly one producer thread and one consumer thread
+template <typename T, size_t Capacity>
+class RingBuffer
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool push(const T& item)
+    {
+        size_t write = writeIndex.load(memory_order_relaxed);
+        if (write - readIndex.load(memory_order_acquire) == Capacity)
+            return false; // full
+        items[write & (Capacity - 1)] = item;
+        writeIndex.store(write + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        size_t read = readIndex.load(memory_order_relaxed);
+        if (read == writeIndex.load(memory_order_acquire))
+            return false; // empty
+        item = items[read & (Capacity - 1)];
+        readIndex.store(read + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    T items[Capacity];
+    atomic<size_t> writeIndex{ 0 };
+    atomic<size_t> readIndex{ 0 };
+};
+
+// Move events are queued by the game thread and written out by a background
+// thread, so logging never waits on the console or the disk. Events that do
+// not fit in the buffer are counted and dropped rather than blocking a move.
+class EventLog
+{
+public:
+    EventLog()
+        : startTime(now()), out(&cout)
+    {
+    }
+
+    ~EventLog()
+    {
+        running = false;
+        if (writer.joinable())
+            writer.join();
+    }
+
+    // Start the writer thread once the options are known; with logging off
+    // there is nothing to write and no thread is started
+    void start()
+    {
+        if (level.load() != EVENT_OFF && !writer.joinable())
+            writer = thread(&EventLog::drain, this);
+    }
+
+    void setLevel(EventLevel newLevel) { level = newLevel; }
+
+    bool enabled(EventLevel eventLevel) const { return eventLevel >= level.load(memory_order_relaxed); }
+
+    // Write to a file instead of the console, as text or as raw MoveEvent records
+    bool openFile(const string& path, bool binaryRecords)
+    {
+        unique_ptr<ofstream> opened(new ofstream(path, binaryRecords ? ios::binary | ios::trunc : ios::trunc));
+        if (!*opened)
+            return false;
+        lock_guard<mutex> lock(sinkMutex);
+        file = move(opened);
+        out = file.get();
+        binary = binaryRecords;
+        return true;
+    }
+
+    void record(EventLevel eventLevel, MoveType type, MoveResult result, int from, int to, int card, int count)
+    {
+        MoveEvent event{};
+        event.timestamp = now();
+        event.level = (signed char)eventLevel;
+        event.type = (signed char)type;
+        event.result = (signed char)result;
+        event.from = (signed char)from;
+        event.to = (signed char)to;
+        event.card = (signed char)card;
+        event.count = (int16_t)count;
+        if (!events.push(event))
+            dropped.fetch_add(1, memory_order_relaxed);
+    }
+
+private:
+    static int64_t now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void drain()
+    {
+        while (true)
+        {
+            bool stopping = !running.load();
+            MoveEvent event;
+            bool wrote = false;
+            {
+                lock_guard<mutex> lock(sinkMutex);
+                while (events.pop(event))
+                {
+                    write(event);
+                    wrote = true;
+                }
+                // Report lost events in the log itself so binary sinks show the gap too
+                long long lost = dropped.load(memory_order_relaxed);
+                if (lost > 0)
+                {
+                    MoveEvent marker{};
+                    marker.timestamp = now();
+                    marker.level = EVENT_INFO;
+                    marker.type = -1;
+                    marker.result = MOVE_EVENTS_DROPPED;
+                    marker.from = marker.to = marker.card = -1;
+                    marker.count = (int16_t)min<long long>(lost, INT16_MAX);
+                    dropped.fetch_sub(marker.count, memory_order_relaxed); // any rest goes in the next marker
+                    write(marker);
+                    wrote = true;
+                }
+                if (wrote)
+                    out->flush();
+            }
+            if (stopping)
+                return;
+            this_thread::sleep_for(chrono::milliseconds(20));
+        }
+    }
+
+    void write(const MoveEvent& event)
+    {
+        if (binary)
+        {
+            out->write(reinterpret_cast<const char*>(&event), sizeof(event));
+            return;
+        }
+
+        static const char* sources[] = { "tableau", "tableau", "waste", "waste", "foundation" };
+        static const char* targets[] = { "tableau", "foundation", "tableau", "foundation", "tableau" };
+        static const char* results[] = { "ok", "invalid pile index", "source pile is empty", "invalid number of cards",
+                                         "a card in the sequence is face down", "cards do not follow alternating color and descending order",
+                                         "only Kings can be placed on an empty tableau", "invalid move" };
+
+        char time[32];
+        snprintf(time, sizeof(time), "%10.3f", (event.timestamp - startTime) / 1e9);
+        if (event.result == MOVE_EVENTS_DROPPED)
+        {
+            *out << time << ' ' << event.count << " event(s) dropped\n";
+            return;
+        }
+        *out << time << ' ' << sources[event.type];
+        if (event.from >= 0)
+            *out << ' ' << event.from + 1;
+        *out << " -> " << targets[event.type] << ' ' << event.to + 1;
+        if (event.card >= 0)
+            *out << ", " << cardName(event.card);
+        if (event.count > 1)
+            *out << " x" << (int)event.count;
+        *out << ": " << results[event.result] << '\n';
+    }
+
+    int64_t startTime;
+    atomic<int> level{ EVENT_DEBUG };
+    RingBuffer<MoveEvent, 1024> events;
+    atomic<long long> dropped{ 0 };
+    atomic<bool> running{ true };
+    mutex sinkMutex; // the sink is only shared between drain and openFile
+    ostream* out;
+    unique_ptr<ofstream> file;
+    bool binary = false;
+    thread writer;
+};
+
+EventLog eventLog;
+
+// Arguments are only evaluated when the level is enabled
+#define LOG_MOVE(level, type, result, from, to, card, count)                    \
+    do                                                                          \
+    {                                                                           \
+        if (eventLog.enabled(level))                                            \
+            eventLog.record(level, type, result, from, to, card, count);        \
+    } while (0)
+
+#else
+
+#define LOG_MOVE(level, type, result, from, to, card, count) ((void)0)
+
+#endif
+
 struct CardNode
 {
     // CardNode structure representing a node in the doubly linked list
@@ -140,6 +429,18 @@ public:
         shuffle(stock.begin(), stock.end(), g);
     }
 
+    // Put the stock in a given order, deck[i] being the card index
+    // (suit * 13 + rank, in initializeDeck order) that ends up at stock[i]
+    void arrangeDeck(const vector<int>& deck)
+    {
+        vector<CardNode*> ordered;
+        for (int index : deck)
+        {
+            ordered.push_back(stock[index]);
+        }
+        stock = ordered;
+    }
+
     void saveState()
     {
         GameState currentState;
@@ -338,19 +639,19 @@ public:
     {
         if (fromIndex < 0 || fromIndex >= 7 || toIndex < 0 || toIndex >= 7)
         {
-            cout << "Invalid tableau indices." << endl;
+            LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_TABLEAU, MOVE_BAD_INDEX, fromIndex, toIndex, -1, numCardsToMove);
             return;
         }
 
         if (tableau[fromIndex].empty())
         {
-            cout << "No cards to move from the source tableau." << endl;
+            LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_TABLEAU, MOVE_EMPTY_SOURCE, fromIndex, toIndex, -1, numCardsToMove);
             return;
         }
 
         if (numCardsToMove < 1 || numCardsToMove > tableau[fromIndex].size())
         {
-            cout << "Invalid number of cards to move." << endl;
+            LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_TABLEAU, MOVE_BAD_COUNT, fromIndex, toIndex, -1, numCardsToMove);
             return;
         }
 
@@ -360,7 +661,7 @@ public:
         {
             if (!(*it)->faceUp)
             {
-                cout << "Cannot move cards: a card in the sequence is face down." << endl;
+                LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_TABLEAU, MOVE_FACE_DOWN, fromIndex, toIndex, -1, numCardsToMove);
                 return;
             }
         }
@@ -372,13 +673,13 @@ public:
             CardNode* targetCard = tableau[toIndex].back();
             if (!tableauValid(firstCardToMove, tableau[toIndex]))
             {
-                cout << "Invalid move: Cards do not follow alternating color and descending order rules." << endl;
+                LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_TABLEAU, MOVE_BAD_SEQUENCE, fromIndex, toIndex, cardIndex(firstCardToMove->card), numCardsToMove);
                 return;
             }
         }
         else if (firstCardToMove->card->rank != "K")
         {
-            cout << "Invalid move: Only Kings can be placed on an empty tableau." << endl;
+            LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_TABLEAU, MOVE_KING_ONLY, fromIndex, toIndex, cardIndex(firstCardToMove->card), numCardsToMove);
             return;
         }
 
@@ -394,28 +695,27 @@ public:
             tableau[fromIndex].back()->faceUp = true;
         }
 
-        cout << "Moved " << numCardsToMove << " card(s) from tableau " << (fromIndex + 1)
-            << " to tableau " << (toIndex + 1) << "." << endl;
+        LOG_MOVE(EVENT_INFO, MOVE_TABLEAU_TO_TABLEAU, MOVE_OK, fromIndex, toIndex, cardIndex(firstCardToMove->card), numCardsToMove);
     }
 
     void moveTableauToFoundation(int fromIndex, int toIndex)
     {
         if (fromIndex < 0 || fromIndex >= 7 || toIndex < 0 || toIndex >= 4)
         {
-            cout << "Invalid indices." << endl;
+            LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_FOUNDATION, MOVE_BAD_INDEX, fromIndex, toIndex, -1, 1);
             return;
         }
 
         if (tableau[fromIndex].empty())
         {
-            cout << "No card." << endl;
+            LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_FOUNDATION, MOVE_EMPTY_SOURCE, fromIndex, toIndex, -1, 1);
             return;
         }
 
         CardNode* cardToMove = tableau[fromIndex].back();
         if (!foundationValid(cardToMove, toIndex))
         {
-            cout << "Invalid move." << endl;
+            LOG_MOVE(EVENT_DEBUG, MOVE_TABLEAU_TO_FOUNDATION, MOVE_NOT_ALLOWED, fromIndex, toIndex, cardIndex(cardToMove->card), 1);
             return;
         }
 
@@ -431,8 +731,7 @@ public:
             tableau[fromIndex].back()->faceUp = true;
         }
 
-        cout << "Moved " << cardToMove->card->rank << " of " << cardToMove->card->suit
-            << " from tableau " << (fromIndex + 1) << " to foundation " << (toIndex + 1) << "." << endl;
+        LOG_MOVE(EVENT_INFO, MOVE_TABLEAU_TO_FOUNDATION, MOVE_OK, fromIndex, toIndex, cardIndex(cardToMove->card), 1);
     }
 
     void moveWasteToTableau(int index)
@@ -442,6 +741,7 @@ public:
             return;
         }
         saveState();
+        LOG_MOVE(EVENT_INFO, MOVE_WASTE_TO_TABLEAU, MOVE_OK, -1, index, cardIndex(waste.back()->card), 1);
         if (tableau[index].empty())
         {
             tableau[index].push_back(waste.back());
@@ -459,6 +759,7 @@ public:
         if (!foundationValid(waste.back(), index) || waste.empty())
             return;
         saveState();
+        LOG_MOVE(EVENT_INFO, MOVE_WASTE_TO_FOUNDATION, MOVE_OK, -1, index, cardIndex(waste.back()->card), 1);
 
         if (foundations[index].empty())
         {
@@ -483,6 +784,7 @@ public:
             return;
         }
         saveState();
+        LOG_MOVE(EVENT_INFO, MOVE_FOUNDATION_TO_TABLEAU, MOVE_OK, fromIndex, toIndex, cardIndex(foundations[fromIndex].back()->card), 1);
         tableau[toIndex].push_back(foundations[fromIndex].back());
         foundations[fromIndex].pop_back();
     }
@@ -523,6 +825,23 @@ public:
 
     // when the user clicks reset button it restarts the game
     void resetGame()
+    {
+        clearTable();
+        initializeDeck();
+        shuffleDeck();
+        setupTableau();
+    }
+
+    // restart with a known deck order, e.g. a deal the solver proved winnable
+    void resetGame(const vector<int>& deck)
+    {
+        clearTable();
+        initializeDeck();
+        arrangeDeck(deck);
+        setupTableau();
+    }
+
+    void clearTable()
     {
         // delete all cards
         saveState();
@@ -537,11 +856,6 @@ public:
             clearPile(tableau[i]);
         }
         selected = nullptr;
-        // and then start over
-
-        initializeDeck();
-        shuffleDeck();
-        setupTableau();
     }
 
     bool gameIsWon()
@@ -587,9 +901,841 @@ public:
         DrawTexturePro(atlas, { 1828, 572, 132, 180 }, { position.x, position.y, 80, 109 }, { 0, 0 }, 0.0f, WHITE);
     }
 };
-int main()
+// Compact copy of a game position used by the solver. Cards are stored by
+// cardIndex, so positions can be copied, hashed and compared without
+// touching the heap.
+struct Position
+{
+    unsigned char tableau[7][20];
+    unsigned char tableauSize[7];
+    unsigned char faceDown[7];   // face-down cards always sit at the bottom of a pile
+    unsigned char stock[24];     // stored back to front: stock[stockSize - 1] is drawn next
+    unsigned char stockSize;
+    unsigned char waste[24];
+    unsigned char wasteSize;
+    unsigned char foundation[4]; // number of cards played to each suit
+
+    static int rankOf(int card) { return card % 13; }
+    static int suitOf(int card) { return card / 13; }
+    static bool isRed(int card) { return suitOf(card) < 2; } // Hearts and Diamonds
+
+    // Snapshot the piles of a running game
+    static Position fromGame(const Solitaire& game)
+    {
+        Position p;
+        memset(&p, 0, sizeof(p));
+        for (int i = 0; i < 7; ++i)
+        {
+            p.tableauSize[i] = (unsigned char)game.tableau[i].size();
+            for (size_t j = 0; j < game.tableau[i].size(); ++j)
+            {
+                p.tableau[i][j] = (unsigned char)cardIndex(game.tableau[i][j]->card);
+                if (!game.tableau[i][j]->faceUp && p.faceDown[i] == j)
+                    p.faceDown[i]++;
+            }
+        }
+        p.stockSize = (unsigned char)game.stock.size();
+        for (size_t j = 0; j < game.stock.size(); ++j)
+        {
+            p.stock[p.stockSize - 1 - j] = (unsigned char)cardIndex(game.stock[j]->card);
+        }
+        p.wasteSize = (unsigned char)game.waste.size();
+        for (size_t j = 0; j < game.waste.size(); ++j)
+        {
+            p.waste[j] = (unsigned char)cardIndex(game.waste[j]->card);
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!game.foundations[i].empty())
+                p.foundation[suitOf(cardIndex(game.foundations[i].back()->card))] = (unsigned char)game.foundations[i].size();
+        }
+        return p;
+    }
+
+    // Deal a fresh game from a deck order, the same way setupTableau does
+    static Position deal(const vector<int>& deck)
+    {
+        Position p;
+        memset(&p, 0, sizeof(p));
+        int remaining = (int)deck.size();
+        for (int i = 0; i < 7; ++i)
+        {
+            for (int j = 0; j <= i; ++j)
+            {
+                p.tableau[i][j] = (unsigned char)deck[--remaining];
+            }
+            p.tableauSize[i] = (unsigned char)(i + 1);
+            p.faceDown[i] = (unsigned char)i;
+        }
+        p.stockSize = (unsigned char)remaining;
+        for (int j = 0; j < remaining; ++j)
+        {
+            p.stock[remaining - 1 - j] = (unsigned char)deck[j];
+        }
+        return p;
+    }
+
+    // With every tableau card face up the game can always be finished: the
+    // lowest card still missing from the foundations is either on top of its
+    // pile or reachable by cycling the stock.
+    bool isSolved() const
+    {
+        for (int i = 0; i < 7; ++i)
+        {
+            if (faceDown[i] != 0)
+                return false;
+        }
+        return true;
+    }
+
+    static uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    // Tableau piles are combined with a sum so that positions which only
+    // differ by the order of the piles share one transposition table entry.
+    uint64_t hash() const
+    {
+        uint64_t h = 0;
+        for (int i = 0; i < 7; ++i)
+        {
+            uint64_t pile = faceDown[i] + 1;
+            for (int j = 0; j < tableauSize[i]; ++j)
+            {
+                pile = mix(pile ^ (uint64_t)(tableau[i][j] + 1) << 8);
+            }
+            h += mix(pile);
+        }
+        uint64_t rest = (uint64_t)foundation[0] | (uint64_t)foundation[1] << 8 | (uint64_t)foundation[2] << 16 | (uint64_t)foundation[3] << 24;
+        for (int j = 0; j < stockSize; ++j)
+        {
+            rest = mix(rest ^ (uint64_t)(stock[j] + 1) << 32);
+        }
+        rest = mix(rest ^ 0xff);
+        for (int j = 0; j < wasteSize; ++j)
+        {
+            rest = mix(rest ^ (uint64_t)(waste[j] + 1) << 40);
+        }
+        return mix(h ^ rest);
+    }
+
+    bool canPlayOnFoundation(int card) const
+    {
+        return foundation[suitOf(card)] == rankOf(card);
+    }
+
+    bool canPlayOnTableau(int card, int pile) const
+    {
+        if (tableauSize[pile] == 0)
+            return rankOf(card) == 12; // Only Kings can start an empty tableau pile
+        int target = tableau[pile][tableauSize[pile] - 1];
+        return rankOf(card) + 1 == rankOf(target) && isRed(card) != isRed(target);
+    }
+
+    // A card is safe to play to its foundation when nothing could ever need
+    // it as a base: both opposite-colour cards one rank lower are already home.
+    bool isSafeFoundationMove(int card) const
+    {
+        int rank = rankOf(card);
+        if (rank <= 1)
+            return true;
+        int other = isRed(card) ? 2 : 0;
+        return foundation[other] >= rank && foundation[other + 1] >= rank;
+    }
+
+    void flipTop(int pile)
+    {
+        if (tableauSize[pile] > 0 && faceDown[pile] == tableauSize[pile])
+            faceDown[pile]--;
+    }
+
+    // Append every position reachable in one move, most promising first
+    void expand(vector<Position>& out) const
+    {
+        // Tableau and waste to foundation; a safe move is played on its own
+        for (int i = 0; i < 7; ++i)
+        {
+            if (tableauSize[i] == 0)
+                continue;
+            int card = tableau[i][tableauSize[i] - 1];
+            if (!canPlayOnFoundation(card))
+                continue;
+            Position next = *this;
+            next.tableauSize[i]--;
+            next.foundation[suitOf(card)]++;
+            next.flipTop(i);
+            if (isSafeFoundationMove(card))
+            {
+                out.clear();
+                out.push_back(next);
+                return;
+            }
+            out.push_back(next);
+        }
+        if (wasteSize > 0 && canPlayOnFoundation(waste[wasteSize - 1]))
+        {
+            int card = waste[wasteSize - 1];
+            Position next = *this;
+            next.wasteSize--;
+            next.foundation[suitOf(card)]++;
+            if (isSafeFoundationMove(card))
+            {
+                out.clear();
+                out.push_back(next);
+                return;
+            }
+            out.push_back(next);
+        }
+
+        // Tableau to tableau, moves that uncover a face-down card first
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (int from = 0; from < 7; ++from)
+            {
+                for (int start = faceDown[from]; start < tableauSize[from]; ++start)
+                {
+                    bool reveals = start == faceDown[from] && faceDown[from] > 0;
+                    if (reveals != (pass == 0))
+                        continue;
+                    int card = tableau[from][start];
+                    for (int to = 0; to < 7; ++to)
+                    {
+                        if (to == from || !canPlayOnTableau(card, to))
+                            continue;
+                        // Moving a whole pile onto an empty one changes nothing
+                        if (start == 0 && tableauSize[to] == 0)
+                            continue;
+                        Position next = *this;
+                        int count = tableauSize[from] - start;
+                        memcpy(&next.tableau[to][tableauSize[to]], &tableau[from][start], count);
+                        next.tableauSize[to] += (unsigned char)count;
+                        next.tableauSize[from] = (unsigned char)start;
+                        next.flipTop(from);
+                        out.push_back(next);
+                    }
+                }
+            }
+            // Waste to tableau goes between revealing and plain tableau moves
+            if (pass == 0 && wasteSize > 0)
+            {
+                int card = waste[wasteSize - 1];
+                for (int to = 0; to < 7; ++to)
+                {
+                    if (!canPlayOnTableau(card, to))
+                        continue;
+                    Position next = *this;
+                    next.tableau[to][next.tableauSize[to]++] = (unsigned char)card;
+                    next.wasteSize--;
+                    out.push_back(next);
+                }
+            }
+        }
+
+        // Draw from the stock, or turn the waste over when the stock runs out
+        if (stockSize > 0)
+        {
+            Position next = *this;
+            next.waste[next.wasteSize++] = next.stock[--next.stockSize];
+            out.push_back(next);
+        }
+        else if (wasteSize > 0)
+        {
+            Position next = *this;
+            memcpy(next.stock, waste, wasteSize);
+            next.stockSize = wasteSize;
+            next.wasteSize = 0;
+            out.push_back(next);
+        }
+
+        // Foundation back to tableau, only useful as a base for a card that
+        // could not be played home yet
+        for (int suit = 0; suit < 4; ++suit)
+        {
+            if (foundation[suit] == 0)
+                continue;
+            int card = suit * 13 + foundation[suit] - 1;
+            if (isSafeFoundationMove(card))
+                continue;
+            for (int to = 0; to < 7; ++to)
+            {
+                if (!canPlayOnTableau(card, to))
+                    continue;
+                Position next = *this;
+                next.tableau[to][next.tableauSize[to]++] = (unsigned char)card;
+                next.foundation[suit]--;
+                out.push_back(next);
+            }
+        }
+    }
+};
+
+// Fixed-size open addressing set of position hashes shared by all solver
+// threads. Slots are claimed with a compare-and-swap, so no thread ever blocks
+// on another one; 0 marks an empty slot.
+class TranspositionTable
+{
+public:
+    explicit TranspositionTable(int log2Size)
+        : slots(new atomic<uint64_t>[(size_t)1 << log2Size]), mask(((size_t)1 << log2Size) - 1)
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i <= mask; ++i)
+        {
+            slots[i].store(0, memory_order_relaxed);
+        }
+    }
+
+    // Returns true if the key was not in the table yet
+    bool insert(uint64_t key)
+    {
+        if (key == 0)
+            key = 1;
+        size_t index = (size_t)key & mask;
+        for (int probe = 0; probe < 64; ++probe)
+        {
+            uint64_t current = slots[index].load(memory_order_relaxed);
+            if (current == key)
+                return false;
+            if (current == 0)
+            {
+                if (slots[index].compare_exchange_strong(current, key, memory_order_relaxed))
+                    return true;
+                if (current == key)
+                    return false;
+            }
+            index = (index + 1) & mask;
+        }
+        return true; // neighbourhood is full, search the position again rather than lose it
+    }
+
+private:
+    unique_ptr<atomic<uint64_t>[]> slots;
+    size_t mask;
+};
+
+enum SolveStatus
+{
+    WINNABLE,
+    UNWINNABLE,
+    UNKNOWN // node limit reached or cancelled
+};
+
+struct SolveResult
+{
+    SolveStatus status;
+    long long nodes;  // positions expanded
+    int depth;        // search depth of the win that was found, every stock draw included; 0 if none
+    double seconds;
+};
+
+// Depth-first search for a winning line. Every thread runs its own DFS stack;
+// when some thread runs dry the busy ones hand over the shallow half of their
+// stacks through a shared pool, and the transposition table makes sure a
+// position is expanded by one thread only.
+class Solver
+{
+public:
+    Solver(int threads = 0, long long nodeLimit = 5000000, int tableBits = 23)
+        : threadCount(threads > 0 ? threads : max(1, (int)thread::hardware_concurrency())), nodeLimit(nodeLimit), table(tableBits)
+    {
+    }
+
+    SolveResult solve(const Position& start)
+    {
+        // The constructor hands over a clean table, so only clear one that
+        // an earlier solve has filled
+        if (tableUsed)
+            table.clear();
+        tableUsed = true;
+
+        auto begin = chrono::steady_clock::now();
+        pool.clear();
+        pool.push_back({ start, 0 });
+        idleWorkers = 0;
+        workWanted = false;
+        finished = false;
+        {
+            // under the lock so a cancel() racing with this reset is not lost
+            lock_guard<mutex> lock(poolMutex);
+            stopped = cancelled.load();
+        }
+        nodes = 0;
+        solutionDepth = -1;
+
+        vector<thread> helpers;
+        for (int i = 1; i < threadCount; ++i)
+        {
+            helpers.emplace_back(&Solver::worker, this);
+        }
+        worker();
+        for (thread& helper : helpers)
+        {
+            helper.join();
+        }
+
+        SolveResult result;
+        result.nodes = nodes.load();
+        result.depth = max(0, solutionDepth.load());
+        if (solutionDepth.load() >= 0)
+            result.status = WINNABLE;
+        else if (stopped.load())
+            result.status = UNKNOWN;
+        else
+            result.status = UNWINNABLE;
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        return result;
+    }
+
+    // Can be called from another thread to abandon the running solve and
+    // every later one
+    void cancel()
+    {
+        cancelled = true;
+        halt();
+    }
+
+    int threads() const { return threadCount; }
+
+private:
+    struct Task
+    {
+        Position position;
+        int depth;
+    };
+
+    void halt()
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopped = true;
+        poolReady.notify_all();
+    }
+
+    // Nodes are counted per thread and added to the shared total in batches
+    // so the threads do not all write to one cache line on every node
+    static const long long nodeBatch = 1024;
+
+    void worker()
+    {
+        vector<Task> local;
+        vector<Position> children;
+        long long counted = 0;
+        while (true)
+        {
+            if (local.empty())
+            {
+                unique_lock<mutex> lock(poolMutex);
+                if (pool.empty())
+                {
+                    if (++idleWorkers == threadCount)
+                    {
+                        finished = true; // every thread is idle and nothing is left to share
+                        poolReady.notify_all();
+                    }
+                    workWanted = true;
+                    poolReady.wait(lock, [this] { return finished || stopped.load() || !pool.empty(); });
+                    if (finished || stopped.load())
+                        break;
+                    --idleWorkers;
+                }
+                local.push_back(pool.back());
+                pool.pop_back();
+
+                // Ask for another split if this took the last shared task and
+                // other threads are still waiting
+                if (pool.empty() && idleWorkers.load() > 0)
+                    workWanted = true;
+            }
+
+            if (stopped.load(memory_order_relaxed))
+                break;
+
+            Task task = local.back();
+            local.pop_back();
+            if (!table.insert(task.position.hash()))
+                continue;
+
+            if (task.position.isSolved())
+            {
+                lock_guard<mutex> lock(poolMutex);
+                if (solutionDepth.load() < 0)
+                    solutionDepth = task.depth;
+                stopped = true;
+                poolReady.notify_all();
+                break;
+            }
+            if (++counted == nodeBatch)
+            {
+                counted = 0;
+                if (nodes.fetch_add(nodeBatch, memory_order_relaxed) + nodeBatch > nodeLimit)
+                {
+                    halt();
+                    break;
+                }
+            }
+
+            children.clear();
+            task.position.expand(children);
+            for (auto it = children.rbegin(); it != children.rend(); ++it)
+            {
+                local.push_back({ *it, task.depth + 1 });
+            }
+
+            // Split work: give the shallowest half of this stack to idle
+            // threads, once per request
+            if (workWanted.load(memory_order_relaxed) && local.size() > 1)
+            {
+                lock_guard<mutex> lock(poolMutex);
+                if (workWanted.load() && pool.empty())
+                {
+                    size_t half = local.size() / 2;
+                    pool.insert(pool.end(), local.begin(), local.begin() + half);
+                    local.erase(local.begin(), local.begin() + half);
+                    workWanted = false;
+                    poolReady.notify_all();
+                }
+            }
+        }
+        nodes.fetch_add(counted, memory_order_relaxed);
+    }
+
+    int threadCount;
+    long long nodeLimit;
+    TranspositionTable table;
+    bool tableUsed = false;
+    mutex poolMutex;
+    condition_variable poolReady;
+    vector<Task> pool;
+    bool finished = false;
+    atomic<int> idleWorkers{ 0 };
+    atomic<bool> cancelled{ false };
+    atomic<int> solutionDepth{ -1 };
+
+    // Read on every node by every thread, so each is padded onto a cache line
+    // of its own (padding rather than alignas, which plain new ignores before C++17)
+    char padding0[64];
+    atomic<bool> stopped{ false };
+    char padding1[64];
+    atomic<bool> workWanted{ false };
+    char padding2[64];
+    atomic<long long> nodes{ 0 };
+    char padding3[64];
+};
+
+// Deck order produced by a fixed seed, used for repeatable solver runs
+vector<int> seededDeck(unsigned seed)
+{
+    vector<int> deck(52);
+    iota(deck.begin(), deck.end(), 0);
+    mt19937 g(seed);
+    shuffle(deck.begin(), deck.end(), g);
+    return deck;
+}
+
+// Compare the single-threaded search with a parallel one (one thread per core
+// by default). The deals are unwinnable ones whose whole search fits in the
+// node limit (105k to 1.9M positions), the slow case of "is this still winnable?".
+// Winnable deals are left out: the search stops at the first win, so their
+// time depends on which branch happens to be tried first, not on the cores.
+void benchmarkSolver(int cores)
+{
+    static const unsigned unwinnableSeeds[] = { 95, 130, 196, 225, 441, 464 };
+    const int repeats = 3; // the parallel search order, and so its time, varies run to run
+    double serialTotal = 0, parallelTotal = 0;
+
+    for (unsigned seed : unwinnableSeeds)
+    {
+        Position start = Position::deal(seededDeck(seed));
+        vector<double> serialTimes, parallelTimes;
+        long long nodes = 0;
+        bool complete = true;
+        for (int run = 0; run < repeats; ++run)
+        {
+            SolveResult one = Solver(1).solve(start);
+            SolveResult all = Solver(cores).solve(start);
+            serialTimes.push_back(one.seconds);
+            parallelTimes.push_back(all.seconds);
+            nodes = one.nodes;
+            complete = complete && one.status == UNWINNABLE && all.status == UNWINNABLE;
+        }
+        sort(serialTimes.begin(), serialTimes.end());
+        sort(parallelTimes.begin(), parallelTimes.end());
+        double serial = serialTimes[repeats / 2];
+        double parallel = parallelTimes[repeats / 2];
+        serialTotal += serial;
+        parallelTotal += parallel;
+
+        cout << "seed " << seed << ": " << nodes << " nodes, median of " << repeats << " runs: 1 thread " << serial << "s, "
+            << cores << " threads " << parallel << "s, speedup " << serial / parallel << "x";
+        if (!complete)
+            cout << " (search did not finish, result not comparable)";
+        cout << "\n";
+    }
+    cout << "total: 1 thread " << serialTotal << "s, " << cores << " threads " << parallelTotal << "s, speedup "
+        << serialTotal / parallelTotal << "x" << endl;
+}
+
+// Run a background thread below normal priority so it never competes with drawing
+void lowerThreadPriority(thread& worker)
+{
+#if defined(_WIN32)
+    SetThreadPriority(worker.native_handle(), -2); // THREAD_PRIORITY_LOWEST
+#elif defined(__linux__) && defined(SCHED_IDLE)
+    sched_param param = {};
+    pthread_setschedparam(worker.native_handle(), SCHED_IDLE, &param);
+#endif
+}
+
+enum Difficulty
+{
+    EASY,
+    MEDIUM,
+    HARD
+};
+
+// A deck order the solver has proven winnable, with how hard it was to prove
+struct WinnableDeal
+{
+    vector<int> deck;
+    long long effort; // positions the solver expanded
+
+    Difficulty difficulty() const
+    {
+        if (effort < 1000)
+            return EASY;
+        if (effort < 50000)
+            return MEDIUM;
+        return HARD;
+    }
+};
+
+// Bounded queue of winnable deals kept full by a low-priority background
+// thread, so "New Game" never has to wait for a solve. The queue is written
+// to disk whenever it grows and read back on start-up.
+class DealPool
+{
+public:
+    DealPool(const string& path, size_t capacity = 20)
+        : path(path), capacity(capacity), solver(1, 1000000, 21)
+    {
+        load();
+        producer = thread(&DealPool::produce, this);
+        lowerThreadPriority(producer);
+    }
+
+    ~DealPool()
+    {
+        {
+            lock_guard<mutex> lock(dealsMutex);
+            running = false;
+        }
+        spaceFree.notify_all();
+        solver.cancel();
+        producer.join();
+        save();
+    }
+
+    // Take the oldest deal without blocking; false if none is ready yet
+    bool pop(WinnableDeal& deal)
+    {
+        {
+            lock_guard<mutex> lock(dealsMutex);
+            if (deals.empty())
+                return false;
+            deal = deals.front();
+            deals.pop_front();
+        }
+        spaceFree.notify_all();
+        save(); // so a crash does not hand out the same deal again
+        return true;
+    }
+
+    size_t size()
+    {
+        lock_guard<mutex> lock(dealsMutex);
+        return deals.size();
+    }
+
+private:
+    void produce()
+    {
+        random_device rd;
+        mt19937 g(rd());
+        vector<int> deck(52);
+        iota(deck.begin(), deck.end(), 0);
+
+        while (true)
+        {
+            {
+                unique_lock<mutex> lock(dealsMutex);
+                spaceFree.wait(lock, [this] { return !running || deals.size() < capacity; });
+                if (!running)
+                    return;
+            }
+
+            shuffle(deck.begin(), deck.end(), g);
+            SolveResult result = solver.solve(Position::deal(deck));
+            if (result.status != WINNABLE)
+                continue; // unwinnable, or too hard to prove within the node limit
+
+            {
+                lock_guard<mutex> lock(dealsMutex);
+                if (!running)
+                    return;
+                deals.push_back({ deck, result.nodes });
+            }
+            save();
+        }
+    }
+
+    // One deal per line: effort, then the 52 card indices
+    void load()
+    {
+        ifstream file(path);
+        string line;
+        while (deals.size() < capacity && getline(file, line))
+        {
+            istringstream fields(line);
+            WinnableDeal deal;
+            deal.deck.resize(52);
+            fields >> deal.effort;
+            for (int& card : deal.deck)
+            {
+                fields >> card;
+            }
+            if (!fields)
+                continue;
+
+            // skip lines that are not a permutation of the deck
+            vector<int> sorted = deal.deck;
+            sort(sorted.begin(), sorted.end());
+            for (int i = 0; i < 52 && !sorted.empty(); ++i)
+            {
+                if (sorted[i] != i)
+                    sorted.clear();
+            }
+            if (!sorted.empty())
+                deals.push_back(deal);
+        }
+    }
+
+    void save()
+    {
+        lock_guard<mutex> saveLock(fileMutex);
+        deque<WinnableDeal> snapshot;
+        {
+            lock_guard<mutex> lock(dealsMutex);
+            snapshot = deals;
+        }
+        ofstream file(path, ios::trunc);
+        for (const WinnableDeal& deal : snapshot)
+        {
+            file << deal.effort;
+            for (int card : deal.deck)
+            {
+                file << ' ' << card;
+            }
+            file << '\n';
+        }
+    }
+
+    string path;
+    size_t capacity;
+    Solver solver;
+    mutex dealsMutex;
+    mutex fileMutex;
+    condition_variable spaceFree;
+    deque<WinnableDeal> deals;
+    bool running = true;
+    thread producer;
+};
+
+// Shared between the frame loop and one background "is this still winnable?"
+// query. The solver is built, run and freed on the query's own thread, so its
+// table never has to be allocated or cleared while a frame is being drawn.
+class WinnableQuery
+{
+public:
+    static future<SolveResult> start(const shared_ptr<WinnableQuery>& query, const Position& position)
+    {
+        return async(launch::async, [query, position]
+            {
+                shared_ptr<Solver> solver = make_shared<Solver>();
+                {
+                    lock_guard<mutex> lock(query->solverMutex);
+                    if (query->cancelled)
+                        solver->cancel();
+                    query->solver = solver;
+                }
+                SolveResult result = solver->solve(position);
+                {
+                    lock_guard<mutex> lock(query->solverMutex);
+                    query->solver.reset();
+                }
+                return result; // the last reference to the solver goes here
+            });
+    }
+
+    // Safe to call before the solver exists or after it has finished
+    void cancel()
+    {
+        lock_guard<mutex> lock(solverMutex);
+        cancelled = true;
+        if (solver)
+            solver->cancel();
+    }
+
+private:
+    mutex solverMutex;
+    shared_ptr<Solver> solver; // only set while the solve runs
+    bool cancelled = false;
+};
+
+int main(int argc, char* argv[])
 {
+    if (argc > 1 && string(argv[1]) == "--bench-solver")
+    {
+        int threads = argc > 2 ? atoi(argv[2]) : 0;
+        benchmarkSolver(threads > 0 ? threads : max(1, (int)thread::hardware_concurrency()));
+        return 0;
+    }
+
+#if SOLITAIRE_EVENT_LOG
+    // --log-level=debug|info|off, --log-file=path for text, --log-binary=path for raw records
+    for (int i = 1; i < argc; ++i)
+    {
+        string option = argv[i];
+        if (option == "--log-level=debug")
+            eventLog.setLevel(EVENT_DEBUG);
+        else if (option == "--log-level=info")
+            eventLog.setLevel(EVENT_INFO);
+        else if (option == "--log-level=off")
+            eventLog.setLevel(EVENT_OFF);
+        else if (option.compare(0, 11, "--log-file=") == 0 && !eventLog.openFile(option.substr(11), false))
+            cout << "Cannot open " << option.substr(11) << endl;
+        else if (option.compare(0, 13, "--log-binary=") == 0 && !eventLog.openFile(option.substr(13), true))
+            cout << "Cannot open " << option.substr(13) << endl;
+    }
+    eventLog.start();
+#endif
+
     Solitaire game;
+    shared_ptr<WinnableQuery> queryState;       // lets the frame loop cancel the running query
+    future<SolveResult> query;                  // "is this still winnable?" query running in the background
+    vector<future<SolveResult>> cancelledQueries; // still winding down, collected once done
+    string solverMessage;       // its answer, or "Solving..." while it runs
+    DealPool dealPool("winnable_deals.txt");
+    bool winnableOnly = false;
+    string dealMessage;
     
     const int screenWidth = 900;
     const int screenHeight = 486;
@@ -606,13 +1752,25 @@ int main()
         Vector2 mousePos = GetMousePosition();
         if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
         {
+            uint64_t before = Position::fromGame(game).hash();
             if (CheckCollisionPointRec(mousePos, { 10, 10, 80, 109 }))
             {
                 game.stockWaste();
             }
             else if (CheckCollisionPointRec(mousePos, { 10, 396, 80, 80 }))
             {
-                game.resetGame();
+                WinnableDeal deal;
+                if (winnableOnly && dealPool.pop(deal))
+                {
+                    const char* difficulties[] = { "Easy deal", "Medium deal", "Hard deal" };
+                    game.resetGame(deal.deck);
+                    dealMessage = difficulties[deal.difficulty()];
+                }
+                else
+                {
+                    game.resetGame(); // pool still empty, fall back to a random deal
+                    dealMessage = winnableOnly ? "Random deal" : "";
+                }
             }
             else if (CheckCollisionPointRec(mousePos, { 10, 306, 80, 80 }))
             {
@@ -638,6 +1796,17 @@ int main()
                     }
                 }
             }
+
+            // Any change to the piles makes the last answer stale
+            if (Position::fromGame(game).hash() != before)
+            {
+                if (query.valid())
+                {
+                    queryState->cancel();
+                    cancelledQueries.push_back(move(query)); // waiting here could stall the frame
+                }
+                solverMessage.clear();
+            }
         }
 
         if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT))
@@ -645,6 +1814,29 @@ int main()
             game.selected = nullptr;
         }
 
+        // W toggles dealing only deals the solver has proven winnable
+        if (IsKeyPressed(KEY_W))
+        {
+            winnableOnly = !winnableOnly;
+            dealMessage = winnableOnly ? "Winnable only" : "";
+        }
+
+        // S asks the solver whether the current position can still be won,
+        // on other threads so the frame loop keeps drawing
+        if (IsKeyPressed(KEY_S) && !query.valid())
+        {
+            queryState = make_shared<WinnableQuery>();
+            query = WinnableQuery::start(queryState, Position::fromGame(game));
+            solverMessage = "Solving...";
+        }
+        if (query.valid() && query.wait_for(chrono::seconds(0)) == future_status::ready)
+        {
+            const char* verdicts[] = { "Winnable", "Lost", "Unsure" };
+            solverMessage = verdicts[query.get().status];
+        }
+        cancelledQueries.erase(remove_if(cancelledQueries.begin(), cancelledQueries.end(), [](future<SolveResult>& cancelled)
+            { return cancelled.wait_for(chrono::seconds(0)) == future_status::ready; }), cancelledQueries.end());
+
         BeginDrawing();
 
         // Initialize Background
@@ -662,6 +1854,8 @@ int main()
         // Undo & Reset Buttons
         DrawTexturePro(game.atlas, { 1968, 572, 132, 132 }, { 10, 306, 80, 80 }, { 0, 0 }, 0.0f, WHITE);
         DrawTexturePro(game.atlas, { 1968, 384, 132, 132 }, { 10, 396, 80, 80 }, { 0, 0 }, 0.0f, WHITE);
+        DrawText(dealMessage.c_str(), 10, 246, 10, WHITE);
+        DrawText(solverMessage.c_str(), 10, 262, 20, WHITE);
 
         stack<ClickableCard*>().swap(game.drawStack); // Clear drawStack before drawing new cards
 
@@ -717,6 +1911,13 @@ int main()
         EndDrawing();
     }
 
+    if (query.valid())
+    {
+        queryState->cancel();
+        query.wait();
+    }
+    cancelledQueries.clear(); // each future waits for its query to finish
+
     UnloadTexture(game.atlas);
     CloseWindow();
 